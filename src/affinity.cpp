@@ -0,0 +1,162 @@
+/*
+ * Dirb++ - Fast, multithreaded version of the original Dirb
+ * Copyright (c) 2023 Oliver Lau <oliver.lau@gmail.com>
+ */
+
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include "affinity.hpp"
+#include "util.hpp"
+
+namespace dirb
+{
+    namespace affinity
+    {
+        namespace
+        {
+            using topology = std::vector<std::vector<unsigned int>>;
+
+#if defined(__linux__)
+            /**
+             * Parses a kernel CPU list like `0-15,32-47`.
+             */
+            std::vector<unsigned int> parse_cpu_list(std::string const &list)
+            {
+                std::vector<unsigned int> cpus;
+                for (auto const &range : util::split(list, ','))
+                {
+                    auto const &[from, to] = util::unpair(range, '-');
+                    try
+                    {
+                        unsigned int const first = static_cast<unsigned int>(std::stoul(from));
+                        unsigned int const last = to.empty() ? first : static_cast<unsigned int>(std::stoul(to));
+                        for (unsigned int cpu = first; cpu <= last; ++cpu)
+                        {
+                            cpus.push_back(cpu);
+                        }
+                    }
+                    catch (std::exception const &)
+                    {
+                        return {};
+                    }
+                }
+                return cpus;
+            }
+#endif
+
+            /**
+             * Returns the CPUs the process may run on, e.g. as restricted
+             * by `taskset` or a cgroup cpuset.
+             */
+            std::vector<unsigned int> allowed_cpus()
+            {
+                std::vector<unsigned int> cpus;
+#if defined(__linux__)
+                cpu_set_t cpuset;
+                CPU_ZERO(&cpuset);
+                if (sched_getaffinity(0, sizeof(cpuset), &cpuset) == 0)
+                {
+                    for (unsigned int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                    {
+                        if (CPU_ISSET(cpu, &cpuset))
+                        {
+                            cpus.push_back(cpu);
+                        }
+                    }
+                }
+#endif
+                if (cpus.empty())
+                {
+                    unsigned int const n = std::max(1U, std::thread::hardware_concurrency());
+                    for (unsigned int cpu = 0; cpu < n; ++cpu)
+                    {
+                        cpus.push_back(cpu);
+                    }
+                }
+                return cpus;
+            }
+
+#if defined(__linux__)
+            std::string read_line(std::string const &filename)
+            {
+                std::ifstream is(filename);
+                std::string line;
+                std::getline(is, line);
+                return line;
+            }
+#endif
+
+            topology read_topology()
+            {
+                std::vector<unsigned int> const allowed = allowed_cpus();
+                topology nodes;
+#if defined(__linux__)
+                // node IDs may be sparse, so don't probe node0, node1, ...
+                for (unsigned int node : parse_cpu_list(read_line("/sys/devices/system/node/online")))
+                {
+                    std::vector<unsigned int> cpus;
+                    for (unsigned int cpu : parse_cpu_list(read_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")))
+                    {
+                        if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+                        {
+                            cpus.push_back(cpu);
+                        }
+                    }
+                    if (!cpus.empty())
+                    {
+                        nodes.push_back(std::move(cpus));
+                    }
+                }
+#endif
+                if (nodes.empty())
+                {
+                    nodes.push_back(allowed);
+                }
+                return nodes;
+            }
+        }
+
+        unsigned int cpu_for_worker(std::size_t worker_index)
+        {
+            static const topology nodes = read_topology();
+            auto const &node = nodes.at(worker_index % nodes.size());
+            return node.at((worker_index / nodes.size()) % node.size());
+        }
+
+        bool pin_current_thread(unsigned int cpu)
+        {
+#if defined(__linux__)
+            if (cpu >= CPU_SETSIZE)
+            {
+                return false;
+            }
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(cpu, &cpuset);
+            return pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) == 0;
+#elif defined(_WIN32)
+            if (cpu >= sizeof(DWORD_PTR) * 8)
+            {
+                return false;
+            }
+            return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{1} << cpu) != 0;
+#else
+            // macOS only supports affinity hints, not hard binding
+            (void)cpu;
+            return false;
+#endif
+        }
+    }
+}
@@ -0,0 +1,34 @@
+/*
+ * Dirb++ - Fast, multithreaded version of the original Dirb
+ * Copyright (c) 2023 Oliver Lau <oliver.lau@gmail.com>
+ */
+
+#ifndef __AFFINITY_HPP__
+#define __AFFINITY_HPP__
+
+#include <cstddef>
+
+namespace dirb
+{
+    namespace affinity
+    {
+        /**
+         * Returns the CPU the worker with index `worker_index` should run
+         * on. Workers are spread round-robin across NUMA nodes first and
+         * across the CPUs of each node second, so that consecutive workers
+         * land on different sockets and every socket gets its share.
+         * Without NUMA information all CPUs form a single node.
+         */
+        unsigned int cpu_for_worker(std::size_t worker_index);
+
+        /**
+         * Binds the calling thread to `cpu`. Memory the thread touches
+         * first afterwards is allocated on the CPU's local NUMA node
+         * (first-touch policy). Returns false if pinning is not supported
+         * on this platform or failed.
+         */
+        bool pin_current_thread(unsigned int cpu);
+    }
+}
+
+#endif // __AFFINITY_HPP__
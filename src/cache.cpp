@@ -0,0 +1,177 @@
+/*
+ * Dirb++ - Fast, multithreaded version of the original Dirb
+ * Copyright (c) 2023 Oliver Lau <oliver.lau@gmail.com>
+ */
+
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+#include "cache.hpp"
+
+namespace dirb
+{
+    namespace
+    {
+        // one entry per line, tab-separated:
+        // key, status, length, body hash (hex), ETag, Last-Modified,
+        // Content-Type, Location, source word
+        constexpr char Delimiter = '\t';
+        constexpr char const *Signature = "# dirb++ response cache v1";
+    }
+
+    bool response_cache::load(std::string const &filename)
+    {
+        std::error_code ec;
+        if (!std::filesystem::exists(filename, ec) && !ec)
+        {
+            return true;
+        }
+        std::ifstream is(filename);
+        if (!is)
+        {
+            return false;
+        }
+        std::string line;
+        if (!std::getline(is, line))
+        {
+            // empty file, e.g. created with `touch`
+            return is.eof() && line.empty();
+        }
+        if (line != Signature)
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (std::getline(is, line))
+        {
+            std::istringstream ls(line);
+            std::string key;
+            std::string status;
+            std::string length;
+            std::string body_hash;
+            entry e{};
+            if (!std::getline(ls, key, Delimiter) ||
+                !std::getline(ls, status, Delimiter) ||
+                !std::getline(ls, length, Delimiter) ||
+                !std::getline(ls, body_hash, Delimiter))
+            {
+                return false;
+            }
+            std::getline(ls, e.etag, Delimiter);
+            std::getline(ls, e.last_modified, Delimiter);
+            std::getline(ls, e.content_type, Delimiter);
+            std::getline(ls, e.location, Delimiter);
+            std::getline(ls, e.word, Delimiter);
+            try
+            {
+                e.status = std::stoi(status);
+                e.length = std::stoull(length);
+                e.body_hash = std::stoull(body_hash, nullptr, 16);
+            }
+            catch (std::exception const &)
+            {
+                return false;
+            }
+            entries_.insert_or_assign(key, e);
+        }
+        return true;
+    }
+
+    bool response_cache::save(std::string const &filename) const
+    {
+        std::string const tmp_filename = filename + ".tmp";
+        {
+            std::ofstream os(tmp_filename, std::ios::trunc);
+            if (!os)
+            {
+                return false;
+            }
+            os << Signature << '\n';
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto const &[key, e] : entries_)
+            {
+                os << key << Delimiter
+                   << e.status << Delimiter
+                   << e.length << Delimiter
+                   << std::hex << e.body_hash << std::dec << Delimiter
+                   << e.etag << Delimiter
+                   << e.last_modified << Delimiter
+                   << e.content_type << Delimiter
+                   << e.location << Delimiter
+                   << e.word << '\n';
+            }
+            if (!os.flush())
+            {
+                return false;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp_filename, filename, ec);
+        return !ec;
+    }
+
+    std::optional<response_cache::entry> response_cache::find(std::string_view key) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it == entries_.end())
+        {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    void response_cache::update(std::string_view key, entry const &e)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end())
+        {
+            it->second = e;
+        }
+        else
+        {
+            entries_.emplace(key, e);
+        }
+    }
+
+    void response_cache::erase(std::string_view key)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end())
+        {
+            entries_.erase(it);
+        }
+    }
+
+    std::vector<std::string> response_cache::source_words(std::string const &base_url) const
+    {
+        std::string const prefix = base_url + '/';
+        std::vector<std::string> result;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto const &[key, e] : entries_)
+        {
+            if (key.starts_with(prefix) && !e.word.empty())
+            {
+                result.push_back(e.word);
+            }
+        }
+        return result;
+    }
+
+    std::uint64_t response_cache::hash(std::string_view data, std::uint64_t seed)
+    {
+        std::uint64_t h = seed;
+        for (unsigned char c : data)
+        {
+            h ^= c;
+            h *= 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+}
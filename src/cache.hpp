@@ -0,0 +1,102 @@
+/*
+ * Dirb++ - Fast, multithreaded version of the original Dirb
+ * Copyright (c) 2023 Oliver Lau <oliver.lau@gmail.com>
+ */
+
+#ifndef __CACHE_HPP__
+#define __CACHE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace dirb
+{
+
+    /**
+     * Thread-safe store of response metadata from previous scans, keyed
+     * by base URL + path. Only findings (responses passing the status code
+     * filter) are kept, so the cache grows with the number of hits, not
+     * with the size of the candidate space.
+     */
+    class response_cache final
+    {
+    public:
+        struct entry
+        {
+            int status;
+            std::string etag;
+            std::string last_modified;
+            std::size_t length;
+            std::uint64_t body_hash;
+            // not repeated in 304 responses, so needed to report unchanged findings
+            std::string content_type;
+            std::string location;
+            // word list entry the path was derived from
+            std::string word;
+        };
+
+        response_cache(){};
+        response_cache(response_cache const &) = delete;
+        response_cache(response_cache &&) = delete;
+
+        /**
+         * Reads cache entries from `filename`. A missing or empty file is
+         * not an error; it yields an empty cache. Returns false if the file
+         * cannot be read or is malformed.
+         */
+        bool load(std::string const &filename);
+
+        /**
+         * Writes all entries to `filename`, replacing it atomically.
+         */
+        bool save(std::string const &filename) const;
+
+        std::optional<entry> find(std::string_view key) const;
+        void update(std::string_view key, entry const &e);
+        void erase(std::string_view key);
+
+        /**
+         * Returns the word list entries that findings below `base_url`
+         * were derived from.
+         */
+        std::vector<std::string> source_words(std::string const &base_url) const;
+
+        inline std::size_t size() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return entries_.size();
+        }
+
+        static constexpr std::uint64_t HashSeed = 0xcbf29ce484222325ULL;
+
+        /**
+         * 64 bit FNV-1a hash, stable across runs and platforms. Pass the
+         * previous result as `seed` to hash data piecewise.
+         */
+        static std::uint64_t hash(std::string_view data, std::uint64_t seed = HashSeed);
+
+    private:
+        // allows lookups by std::string_view without building a std::string
+        struct key_hash
+        {
+            using is_transparent = void;
+            inline std::size_t operator()(std::string_view key) const
+            {
+                return std::hash<std::string_view>{}(key);
+            }
+        };
+
+        std::unordered_map<std::string, entry, key_hash, std::equal_to<>> entries_{};
+        mutable std::mutex mutex_;
+    };
+
+}
+
+#endif // __CACHE_HPP__
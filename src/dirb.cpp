@@ -4,8 +4,14 @@
  */
 
 #include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <numeric>
+#include <optional>
 #include <sstream>
+#include <thread>
 
+#include "affinity.hpp"
 #include "dirb.hpp"
 #include "certs.hpp"
 
@@ -63,20 +69,120 @@ namespace dirb
         {401, true},
         {403, true}};
 
-    void dirb_runner::log(std::string const &message)
+    void dirb_runner::log(std::string_view message)
     {
         const std::lock_guard<std::mutex> lock(output_mutex_);
+        if (finding_times_.size() < MaxRecordedFindings)
+        {
+            finding_times_.push_back(scan_timer_->elapsed());
+        }
+        if (result_handler_)
+        {
+            result_handler_(message);
+            return;
+        }
         std::cout << message << std::endl;
     }
 
-    void dirb_runner::error(std::string const &message)
+    void dirb_runner::error(std::string_view message)
     {
         const std::lock_guard<std::mutex> lock(output_mutex_);
         std::cerr << message << std::endl;
     }
 
-    void dirb_runner::http_worker()
+    /**
+     * Adds `url` + `suffix`, derived from `word`, to the frontier. The
+     * caller must hold `queue_mutex_` unless no workers are running.
+     */
+    void dirb_runner::enqueue(std::string_view url, std::string_view word, priority prio, std::string_view suffix)
+    {
+        std::string entry;
+        entry.reserve(url.size() + suffix.size());
+        entry.append(url).append(suffix);
+        url_queue_.push(frontier_entry{
+            fifo_ ? 0 : static_cast<int>(prio),
+            queue_seq_++,
+            std::move(entry),
+            std::string{word}});
+    }
+
+    /**
+     * Fetches the next URL to probe. URLs queued explicitly (variations)
+     * take precedence over candidates generated from the word list, or
+     * follow them in FIFO mode; failed requests are retried last. `word`
+     * receives the word list entry the URL was derived from, `attempt`
+     * the number of previous failed attempts. Returns false if there is
+     * nothing left to do.
+     */
+    bool dirb_runner::next_url(std::string &url, std::string &word, unsigned int &attempt)
     {
+        size_t const n = mutator_.variants_per_word();
+        for (;;)
+        {
+            size_t index;
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+                attempt = 0;
+                bool const candidates_left = next_candidate_ < std::min(candidate_end_, candidate_count());
+                if (!url_queue_.empty() && (!fifo_ || !candidates_left))
+                {
+                    url = url_queue_.top().url;
+                    word = url_queue_.top().word;
+                    url_queue_.pop();
+                    return true;
+                }
+                if (!candidates_left)
+                {
+                    if (retry_queue_.empty())
+                    {
+                        return false;
+                    }
+                    url = retry_queue_.front().url;
+                    word = retry_queue_.front().word;
+                    attempt = retry_queue_.front().attempt;
+                    retry_queue_.pop();
+                    return true;
+                }
+                index = next_candidate_++;
+            }
+            // skip candidates a case rule did not change; they were or
+            // will be probed under a lower index, so leases stay aligned
+            std::string const &source = words_.at(word_order_.at(index / n));
+            if (mutator_.apply(source, index % n, url))
+            {
+                word = source;
+                return true;
+            }
+        }
+    }
+
+    void dirb_runner::http_worker(size_t worker_index)
+    {
+        // pin before anything is allocated so that the worker's buffers
+        // are placed on the NUMA node local to its CPU
+        if (pin_threads_ && !affinity::pin_current_thread(affinity::cpu_for_worker(worker_index)))
+        {
+            error("\u001b[33;1mWARNING:\u001b[0m cannot pin worker thread " + std::to_string(worker_index));
+        }
+        // reused for every request, so they only allocate until they
+        // have grown to the longest URL and result line
+        std::string url;
+        std::string word;
+        std::string key;
+        std::string line;
+        size_t requests = 0;
+        // refer to header values in place instead of copying them
+        auto header_value = [](httplib::Response const &res, char const *key, std::string_view fallback)
+        {
+            auto it = res.headers.find(key);
+            return it != res.headers.end() ? std::string_view{it->second} : fallback;
+        };
+        auto append_number = [](std::string &str, auto value)
+        {
+            char buf[24];
+            auto const [end, ec] = std::to_chars(std::begin(buf), std::end(buf), value);
+            str.append(buf, end);
+        };
         httplib::Client cli(base_url_.c_str());
         if (verify_certs_)
         {
@@ -105,18 +211,10 @@ namespace dirb
         cli.set_default_headers(headers_);
         while (!do_quit_)
         {
-            std::string url;
+            unsigned int attempt;
+            if (!next_url(url, word, attempt))
             {
-                std::lock_guard<std::mutex> lock(queue_mutex_);
-                if (url_queue_.empty())
-                {
-                    return;
-                }
-                else
-                {
-                    url = url_queue_.front();
-                    url_queue_.pop();
-                }
+                break;
             }
             if (url.empty())
             {
@@ -124,30 +222,60 @@ namespace dirb
             }
             if (url.front() != '/')
             {
-                url = '/' + url;
+                url.insert(0, 1, '/');
+            }
+            std::optional<response_cache::entry> cached;
+            httplib::Headers conditional_headers;
+            if (cache_ != nullptr)
+            {
+                key.assign(base_url_).append(url);
+                cached = cache_->find(key);
+                if (cached && !cached->etag.empty())
+                {
+                    conditional_headers.emplace("If-None-Match", cached->etag);
+                }
+                if (cached && !cached->last_modified.empty())
+                {
+                    conditional_headers.emplace("If-Modified-Since", cached->last_modified);
+                }
             }
             // TODO: implement all methods, i.e. HEAD, POST, OPTIONS ...
-            if (httplib::Result res = cli.Get(url.c_str()))
+            httplib::Result res = cli.Get(url.c_str(), conditional_headers);
+            ++requests;
+            if (res)
             {
-                std::stringstream ss;
-                ss << res->status << ';'
-                   << '"' << url << '"' << ';'
-                   << '"' << (res->has_header("Content-Type") ? res->get_header_value("Content-Type") : "") << '"' << ';'
-                   << (res->has_header("Content-Length") ? res->get_header_value("Content-Length") : 0) << ';'
-                   << '"' << (res->has_header("Set-Cookie") ? res->get_header_value("Set-Cookie") : "") << '"' << ';';
-                if (300 <= res->status && res->status < 400)
+                // 304 Not Modified means the cached finding is still valid
+                bool const unchanged = cached && res->status == 304;
+                int const status = unchanged ? cached->status : res->status;
+                // the same length is reported for fresh and unchanged findings
+                size_t length = unchanged ? cached->length : res->body.size();
+                if (!unchanged)
                 {
-                    if (res->has_header("Location"))
-                    {
-                        ss << res->get_header_value("Location");
-                    }
+                    std::string_view const content_length = header_value(*res, "Content-Length", "");
+                    std::from_chars(content_length.data(), content_length.data() + content_length.size(), length);
+                }
+                line.clear();
+                append_number(line, status);
+                line.append(";\"")
+                    .append(qualify_urls_ ? std::string_view{base_url_} : std::string_view{})
+                    .append(url)
+                    .append("\";\"")
+                    .append(unchanged ? std::string_view{cached->content_type} : header_value(*res, "Content-Type", ""))
+                    .append("\";");
+                append_number(line, length);
+                line.append(";\"")
+                    .append(header_value(*res, "Set-Cookie", ""))
+                    .append("\";");
+                if (300 <= status && status < 400)
+                {
+                    line.append(unchanged ? std::string_view{cached->location} : header_value(*res, "Location", ""));
                 }
-                else if (res->status == 200)
+                else if (status == 200)
                 {
                     std::lock_guard<std::mutex> lock(queue_mutex_);
                     for (auto const &v : probe_variations_)
                     {
-                        url_queue_.push(url + v);
+                        enqueue(url, word, priority::variation, v);
                     }
                     if (verify_certs_)
                     {
@@ -157,22 +285,99 @@ namespace dirb
                         }
                     }
                 }
-                if (status_codes_.contains(res->status))
+                bool changed = !unchanged;
+                if (cache_ != nullptr && !unchanged)
                 {
-                    log(ss.str());
+                    if (status_codes_.contains(status))
+                    {
+                        response_cache::entry const e{
+                            status,
+                            std::string{header_value(*res, "ETag", "")},
+                            std::string{header_value(*res, "Last-Modified", "")},
+                            length,
+                            response_cache::hash(res->body),
+                            std::string{header_value(*res, "Content-Type", "")},
+                            std::string{header_value(*res, "Location", "")},
+                            std::string{word}};
+                        changed = !cached || cached->status != e.status || cached->body_hash != e.body_hash;
+                        cache_->update(key, e);
+                    }
+                    else if (cached)
+                    {
+                        cache_->erase(key);
+                    }
+                }
+                if (status_codes_.contains(status) && (changed || !diff_mode_))
+                {
+                    log(line);
                 }
             }
             else
             {
                 std::stringstream ss;
-                ss << (-1) << ';' << '"' << url << '"' << ';' << ';' << ';' << ';' << res.error();
+                ss << (-1) << ';' << '"' << (qualify_urls_ ? std::string_view{base_url_} : std::string_view{}) << url << '"' << ';' << ';' << ';' << ';' << res.error();
                 error(ss.str());
+                if (attempt < MaxRetries)
                 {
                     std::lock_guard<std::mutex> lock(queue_mutex_);
-                    url_queue_.push(url);
+                    retry_queue_.push(retry_entry{url, word, attempt + 1});
                 }
             }
         }
-        return;
+        // each worker owns its slot, so no synchronization is needed
+        worker_requests_.at(worker_index) += requests;
+    }
+
+    std::uint64_t dirb_runner::candidate_fingerprint() const
+    {
+        std::uint64_t h = response_cache::hash(mutator_.describe());
+        for (auto i : word_order_)
+        {
+            h = response_cache::hash(words_.at(i), h);
+            h = response_cache::hash("\n", h);
+        }
+        return h;
+    }
+
+    void dirb_runner::prioritize_words(std::unordered_map<std::string, size_t> const &frequencies,
+                                       std::unordered_set<std::string> const &previous_hits)
+    {
+        if (fifo_)
+        {
+            return;
+        }
+        using score = std::pair<bool, size_t>;
+        std::vector<score> scores;
+        scores.reserve(words_.size());
+        for (auto const &word : words_)
+        {
+            auto it = frequencies.find(word);
+            scores.emplace_back(previous_hits.contains(word), it != frequencies.end() ? it->second : 0);
+        }
+        std::iota(word_order_.begin(), word_order_.end(), size_t{0});
+        std::stable_sort(word_order_.begin(), word_order_.end(), [&scores](size_t a, size_t b)
+                         { return scores.at(a) > scores.at(b); });
+    }
+
+    void dirb_runner::run(size_t num_threads)
+    {
+        if (!scan_timer_)
+        {
+            scan_timer_.emplace();
+        }
+        if (worker_requests_.size() < num_threads)
+        {
+            worker_requests_.resize(num_threads, 0);
+        }
+        std::vector<std::thread> workers;
+        workers.reserve(num_threads);
+        for (size_t i = 0; i < num_threads; ++i)
+        {
+            workers.emplace_back(&dirb_runner::http_worker, this, i);
+        }
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
     }
 }
@@ -7,10 +7,16 @@
 #define __DIRB_HPP__
 
 #include <atomic>
+#include <functional>
+#include <limits>
 #include <mutex>
+#include <numeric>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <queue>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #ifndef CPPHTTPLIB_OPENSSL_SUPPORT
@@ -18,6 +24,10 @@
 #endif
 #include <httplib.h>
 
+#include "cache.hpp"
+#include "mutator.hpp"
+#include "timer.hpp"
+
 namespace dirb
 {
 
@@ -38,6 +48,19 @@ namespace dirb
     class dirb_runner final
     {
     public:
+        /**
+         * Priority of URLs queued explicitly. Higher priorities are probed
+         * first; URLs of equal priority in the order they were queued.
+         * All of them are probed before candidates from the word list.
+         * Failed requests are not part of this order: they are retried
+         * after all candidates, at most `MaxRetries` times.
+         */
+        enum class priority : int
+        {
+            normal,
+            variation,
+        };
+
         dirb_runner(){};
         dirb_runner(dirb_runner const &) = delete;
         dirb_runner(dirb_runner &&) = delete;
@@ -61,6 +84,14 @@ namespace dirb
         {
             this->base_url_ = base_url;
         }
+        /**
+         * Reports full URLs instead of paths in result lines, so that
+         * findings of different base URLs can be told apart.
+         */
+        inline void set_qualify_urls(bool qualify_urls)
+        {
+            this->qualify_urls_ = qualify_urls;
+        }
         inline void set_username(std::string const &username)
         {
             this->username_ = username;
@@ -93,30 +124,176 @@ namespace dirb
         {
             this->probe_variations_ = probe_variations;
         }
-        inline void set_url_queue(std::queue<std::string> const &url_queue)
+        inline void set_url_queue(std::queue<std::string> url_queue)
+        {
+            url_queue_ = {};
+            for (; !url_queue.empty(); url_queue.pop())
+            {
+                enqueue(url_queue.front(), {}, priority::normal);
+            }
+        }
+        inline void add_to_queue(std::string const &url, priority prio = priority::normal)
         {
-            this->url_queue_ = url_queue;
+            enqueue(url, {}, prio);
         }
-        inline void add_to_queue(std::string const &url)
+        /**
+         * Disables all prioritization: candidates are probed in word list
+         * order, followed by queued URLs (e.g. variations of findings) in
+         * the order they were queued.
+         */
+        inline void set_fifo(bool fifo)
         {
-            url_queue_.emplace(url);
+            this->fifo_ = fifo;
         }
         inline size_t url_queue_size() const
         {
             return url_queue_.size();
         }
+        /**
+         * Adds `word` to the word list. Returns false if the candidate
+         * space would no longer be addressable.
+         */
+        inline bool add_word(std::string const &word)
+        {
+            if (mutator_.variants_per_word() > std::numeric_limits<size_t>::max() / (words_.size() + 1))
+            {
+                return false;
+            }
+            word_order_.push_back(words_.size());
+            words_.push_back(word);
+            return true;
+        }
+        /**
+         * Sets the mutation rules. Returns false if the candidate space
+         * would no longer be addressable with the words added so far.
+         */
+        inline bool set_mutator(mutator const &m)
+        {
+            if (!words_.empty() && m.variants_per_word() > std::numeric_limits<size_t>::max() / words_.size())
+            {
+                return false;
+            }
+            this->mutator_ = m;
+            return true;
+        }
+        /**
+         * Number of candidates in the word list × mutation rule product,
+         * not counting URLs added to the queue directly.
+         */
+        inline size_t candidate_count() const
+        {
+            return words_.size() * mutator_.variants_per_word();
+        }
+        /**
+         * Hash over the mutation rules and the word list in its current
+         * order. Two runners with equal fingerprints map every candidate
+         * index to the same path.
+         */
+        std::uint64_t candidate_fingerprint() const;
+        /**
+         * Restricts the scan to candidates with indexes in [begin, end).
+         */
+        inline void set_candidate_range(size_t begin, size_t end)
+        {
+            this->next_candidate_ = begin;
+            this->candidate_end_ = end;
+        }
+        /**
+         * Passes result lines to `handler` instead of printing them to
+         * standard output. The handler is called with the output lock held.
+         */
+        inline void set_result_handler(std::function<void(std::string_view)> const &handler)
+        {
+            this->result_handler_ = handler;
+        }
+        /**
+         * Revalidates responses against `cache` with conditional requests
+         * and records findings in it. The cache must outlive the scan.
+         */
+        inline void set_response_cache(response_cache *cache)
+        {
+            this->cache_ = cache;
+        }
+        /**
+         * Only report findings that are new or changed compared to the
+         * response cache.
+         */
+        inline void set_diff_mode(bool diff_mode)
+        {
+            this->diff_mode_ = diff_mode;
+        }
+        inline void set_pin_threads(bool pin_threads)
+        {
+            this->pin_threads_ = pin_threads;
+        }
+        inline size_t request_count() const
+        {
+            return std::accumulate(worker_requests_.begin(), worker_requests_.end(), size_t{0});
+        }
+        /**
+         * Number of requests sent by each worker, indexed by worker.
+         */
+        inline std::vector<size_t> const &worker_request_counts() const
+        {
+            return worker_requests_;
+        }
+        /**
+         * Time elapsed since the start of the scan for each of the first
+         * `MaxRecordedFindings` findings.
+         */
+        inline std::vector<timer::duration> const &finding_times() const
+        {
+            return finding_times_;
+        }
         inline void set_status_code_filter(std::unordered_map<int, bool> const &codes)
         {
             this->status_codes_ = codes;
         }
 
-        void http_worker();
+        /**
+         * Probes URLs until the queue is exhausted. `worker_index` selects
+         * the CPU the worker is pinned to if pinning is enabled.
+         */
+        void http_worker(size_t worker_index);
+
+        /**
+         * Runs `num_threads` workers and waits until all of them are done.
+         */
+        void run(size_t num_threads);
+
+        /**
+         * Reorders the word list so that likely hits are probed first:
+         * words in `previous_hits` (e.g. the words earlier findings were
+         * derived from) before all others, then by descending frequency.
+         * Words with equal scores keep the order in which they were added,
+         * regardless of earlier calls. Does nothing in FIFO mode.
+         */
+        void prioritize_words(std::unordered_map<std::string, size_t> const &frequencies,
+                              std::unordered_set<std::string> const &previous_hits);
 
         static const std::string DefaultUserAgent;
         static const std::unordered_map<int, bool> DefaultStatusCodeFilter;
+        static constexpr size_t MaxRecordedFindings = 1000U;
+        static constexpr unsigned int MaxRetries = 3U;
 
     private:
+        struct frontier_entry
+        {
+            int prio;
+            size_t seq;
+            std::string url;
+            // word list entry the URL was derived from
+            std::string word;
+
+            // std::priority_queue pops the greatest element first
+            inline bool operator<(frontier_entry const &other) const
+            {
+                return prio != other.prio ? prio < other.prio : seq > other.seq;
+            }
+        };
+
         std::string base_url_{};
+        bool qualify_urls_{false};
         std::mutex output_mutex_;
         bool follow_redirects_{false};
         httplib::Headers headers_{};
@@ -127,13 +304,39 @@ namespace dirb
         std::string body_{};
         bool verify_certs_{false};
         http::verb method_{http::verb::get};
-        std::queue<std::string> url_queue_;
+        std::priority_queue<frontier_entry> url_queue_;
+        struct retry_entry
+        {
+            std::string url;
+            std::string word;
+            unsigned int attempt;
+        };
+
+        std::queue<retry_entry> retry_queue_;
+        size_t queue_seq_{0};
+        bool fifo_{false};
+        std::vector<timer::duration> finding_times_{};
+        std::optional<timer> scan_timer_{};
+        std::vector<std::string> words_{};
+        // indexes into `words_` in probe order, so that reprioritizing
+        // always starts from the order the words were added in
+        std::vector<size_t> word_order_{};
+        mutator mutator_{};
+        size_t next_candidate_{0};
+        size_t candidate_end_{std::numeric_limits<size_t>::max()};
+        std::function<void(std::string_view)> result_handler_{};
         std::mutex queue_mutex_;
         std::atomic_bool do_quit_{false};
+        bool pin_threads_{false};
+        response_cache *cache_{nullptr};
+        bool diff_mode_{false};
+        std::vector<size_t> worker_requests_{};
         std::unordered_map<int, bool> status_codes_{DefaultStatusCodeFilter};
 
-        void log(std::string const &message);
-        void error(std::string const &message);
+        void enqueue(std::string_view url, std::string_view word, priority prio, std::string_view suffix = {});
+        bool next_url(std::string &url, std::string &word, unsigned int &attempt);
+        void log(std::string_view message);
+        void error(std::string_view message);
     };
 
 }
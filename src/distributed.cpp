@@ -0,0 +1,566 @@
+/*
+ * Dirb++ - Fast, multithreaded version of the original Dirb
+ * Copyright (c) 2023 Oliver Lau <oliver.lau@gmail.com>
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string_view>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <csignal>
+#include <cerrno>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "distributed.hpp"
+
+namespace dirb
+{
+    namespace distributed
+    {
+        namespace
+        {
+            constexpr std::string_view UnixPrefix = "unix:";
+
+            void print_error(std::string const &message)
+            {
+                std::cerr << "\u001b[31;1mERROR:\u001b[0m " << message << std::endl;
+            }
+
+#if !defined(_WIN32)
+            /**
+             * Opens a listening or connected socket for `address`, which is
+             * either `unix:/path/to/socket` or `host:port`. Returns -1 on error.
+             */
+            int open_socket(std::string const &address, bool listening)
+            {
+                if (address.starts_with(UnixPrefix))
+                {
+                    std::string const path = address.substr(UnixPrefix.size());
+                    sockaddr_un addr{};
+                    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+                    {
+                        print_error("invalid socket path '" + path + "'");
+                        return -1;
+                    }
+                    addr.sun_family = AF_UNIX;
+                    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+                    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                    if (fd < 0)
+                    {
+                        print_error(std::strerror(errno));
+                        return -1;
+                    }
+                    int rc;
+                    if (listening)
+                    {
+                        // remove a stale socket left behind by a previous run,
+                        // but never take over the socket of a running coordinator
+                        struct stat st;
+                        if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+                        {
+                            int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+                            if (probe >= 0)
+                            {
+                                bool const alive = connect(probe, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+                                bool const stale = !alive && errno == ECONNREFUSED;
+                                close(probe);
+                                if (alive)
+                                {
+                                    print_error(address + ": already in use by another process");
+                                    close(fd);
+                                    return -1;
+                                }
+                                if (stale)
+                                {
+                                    unlink(path.c_str());
+                                }
+                            }
+                        }
+                        rc = bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+                        if (rc == 0)
+                        {
+                            rc = listen(fd, SOMAXCONN);
+                        }
+                    }
+                    else
+                    {
+                        rc = connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+                    }
+                    if (rc != 0)
+                    {
+                        print_error(address + ": " + std::strerror(errno));
+                        close(fd);
+                        return -1;
+                    }
+                    return fd;
+                }
+                auto const colon = address.rfind(':');
+                if (colon == std::string::npos)
+                {
+                    print_error("invalid address '" + address + "', expected host:port or unix:path");
+                    return -1;
+                }
+                std::string host = address.substr(0, colon);
+                std::string const port = address.substr(colon + 1);
+                if (host.size() > 1 && host.front() == '[' && host.back() == ']')
+                {
+                    host = host.substr(1, host.size() - 2);
+                }
+                addrinfo hints{};
+                hints.ai_family = AF_UNSPEC;
+                hints.ai_socktype = SOCK_STREAM;
+                hints.ai_flags = listening ? AI_PASSIVE : 0;
+                addrinfo *res = nullptr;
+                int rc = getaddrinfo(host.empty() || host == "*" ? nullptr : host.c_str(), port.c_str(), &hints, &res);
+                if (rc != 0)
+                {
+                    print_error(address + ": " + gai_strerror(rc));
+                    return -1;
+                }
+                int fd = -1;
+                for (addrinfo *ai = res; ai != nullptr; ai = ai->ai_next)
+                {
+                    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+                    if (fd < 0)
+                    {
+                        continue;
+                    }
+                    int const on = 1;
+                    if (listening)
+                    {
+                        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+                        if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, SOMAXCONN) == 0)
+                        {
+                            break;
+                        }
+                    }
+                    else if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+                    {
+                        // detect coordinators that vanish without closing the connection
+                        setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+                        break;
+                    }
+                    close(fd);
+                    fd = -1;
+                }
+                if (fd < 0)
+                {
+                    print_error(address + ": " + std::strerror(errno));
+                }
+                freeaddrinfo(res);
+                return fd;
+            }
+
+            bool send_line(int fd, std::string const &line)
+            {
+                std::string const data = line + '\n';
+                std::size_t sent = 0;
+                while (sent < data.size())
+                {
+                    ssize_t n = send(fd, data.data() + sent, data.size() - sent, 0);
+                    if (n < 0 && errno == EINTR)
+                    {
+                        continue;
+                    }
+                    if (n <= 0)
+                    {
+                        return false;
+                    }
+                    sent += static_cast<std::size_t>(n);
+                }
+                return true;
+            }
+
+            /**
+             * Reads whatever is available on `fd` into `buffer`.
+             * Returns false if the connection was closed or failed.
+             */
+            bool receive(int fd, std::string &buffer)
+            {
+                char chunk[4096];
+                ssize_t n;
+                do
+                {
+                    n = recv(fd, chunk, sizeof(chunk), 0);
+                } while (n < 0 && errno == EINTR);
+                if (n <= 0)
+                {
+                    return false;
+                }
+                buffer.append(chunk, static_cast<std::size_t>(n));
+                return true;
+            }
+
+            /**
+             * Removes the first complete line from `buffer` and stores it
+             * in `line`. Returns false if `buffer` holds no complete line.
+             */
+            bool take_line(std::string &buffer, std::string &line)
+            {
+                auto const eol = buffer.find('\n');
+                if (eol == std::string::npos)
+                {
+                    return false;
+                }
+                line = buffer.substr(0, eol);
+                buffer.erase(0, eol + 1);
+                return true;
+            }
+#endif
+        }
+
+        struct coordinator::connection
+        {
+            int fd;
+            std::chrono::steady_clock::time_point last_seen{std::chrono::steady_clock::now()};
+            std::string buffer{};
+            bool ready{false};
+            std::optional<lease> current{};
+            std::vector<std::string> results{};
+        };
+
+        std::size_t coordinator::total_leases() const
+        {
+            if (lease_size_ == 0)
+            {
+                return 0;
+            }
+            return targets_.size() * ((candidate_count_ + lease_size_ - 1) / lease_size_);
+        }
+
+        bool coordinator::next_lease(lease &l)
+        {
+            if (!reissued_.empty())
+            {
+                l = reissued_.front();
+                reissued_.pop_front();
+                return true;
+            }
+            if (next_target_ >= targets_.size() || lease_size_ == 0)
+            {
+                return false;
+            }
+            l = lease{next_lease_id_++, next_target_, next_begin_, std::min(next_begin_ + lease_size_, candidate_count_)};
+            next_begin_ = l.end;
+            if (next_begin_ >= candidate_count_)
+            {
+                next_begin_ = 0;
+                ++next_target_;
+            }
+            return true;
+        }
+
+#if !defined(_WIN32)
+        void coordinator::drop(connection &conn)
+        {
+            if (conn.current)
+            {
+                if (verbosity_ > 0)
+                {
+                    std::cerr << "Worker lost, re-issuing lease " << conn.current->id << std::endl;
+                }
+                reissued_.push_back(*conn.current);
+                conn.current.reset();
+            }
+            close(conn.fd);
+            conn.fd = -1;
+        }
+
+        void coordinator::assign(connection &conn)
+        {
+            lease l;
+            if (!next_lease(l))
+            {
+                return;
+            }
+            conn.current = l;
+            conn.results.clear();
+            conn.last_seen = std::chrono::steady_clock::now();
+            std::ostringstream ss;
+            ss << "LEASE " << l.id << ' ' << l.begin << ' ' << l.end << ' '
+               << (targets_.size() > 1 ? 1 : 0) << ' ' << targets_.at(l.target);
+            if (!send_line(conn.fd, ss.str()))
+            {
+                drop(conn);
+            }
+        }
+
+        bool coordinator::handle_line(connection &conn, std::string const &line)
+        {
+            std::istringstream is(line);
+            std::string command;
+            is >> command;
+            if (command == "HELLO")
+            {
+                std::size_t count;
+                std::uint64_t fingerprint;
+                if (!(is >> count >> std::hex >> fingerprint) || count != candidate_count_ || fingerprint != fingerprint_)
+                {
+                    send_line(conn.fd, "ERROR candidate space mismatch: word lists, word statistics, -X/-M options or --fifo differ from the coordinator's");
+                    return false;
+                }
+                conn.ready = true;
+                return true;
+            }
+            if (command == "ALIVE")
+            {
+                return true;
+            }
+            std::size_t id;
+            if (!conn.ready || !(is >> id))
+            {
+                return false;
+            }
+            if (command == "RESULT")
+            {
+                if (conn.current && conn.current->id == id)
+                {
+                    is.get();
+                    std::string result;
+                    std::getline(is, result);
+                    conn.results.push_back(result);
+                }
+                return true;
+            }
+            if (command == "COMPLETE")
+            {
+                if (conn.current && conn.current->id == id)
+                {
+                    for (auto const &result : conn.results)
+                    {
+                        std::cout << result << '\n';
+                    }
+                    std::cout << std::flush;
+                    conn.results.clear();
+                    conn.current.reset();
+                    ++completed_;
+                    if (verbosity_ > 0)
+                    {
+                        std::cerr << "Completed " << completed_ << " of " << total_leases() << " leases" << std::endl;
+                    }
+                }
+                return true;
+            }
+            return false;
+        }
+
+        bool coordinator::run(std::string const &address)
+        {
+            std::signal(SIGPIPE, SIG_IGN);
+            int listener = open_socket(address, true);
+            if (listener < 0)
+            {
+                return false;
+            }
+            std::list<connection> connections;
+            bool ok = true;
+            while (completed_ < total_leases())
+            {
+                std::vector<pollfd> fds;
+                fds.push_back(pollfd{listener, POLLIN, 0});
+                for (auto const &conn : connections)
+                {
+                    fds.push_back(pollfd{conn.fd, POLLIN, 0});
+                }
+                // wake up regularly to detect workers that went silent
+                if (poll(fds.data(), static_cast<nfds_t>(fds.size()), 1000) < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    print_error(std::string("poll() failed: ") + std::strerror(errno));
+                    ok = false;
+                    break;
+                }
+                std::size_t i = 1;
+                for (auto &conn : connections)
+                {
+                    if ((fds.at(i++).revents & (POLLIN | POLLHUP | POLLERR)) == 0)
+                    {
+                        continue;
+                    }
+                    if (!receive(conn.fd, conn.buffer))
+                    {
+                        drop(conn);
+                        continue;
+                    }
+                    conn.last_seen = std::chrono::steady_clock::now();
+                    std::string line;
+                    while (conn.fd >= 0 && take_line(conn.buffer, line))
+                    {
+                        if (!handle_line(conn, line))
+                        {
+                            drop(conn);
+                        }
+                    }
+                }
+                // a host that lost power or network never closes its connection
+                auto const now = std::chrono::steady_clock::now();
+                for (auto &conn : connections)
+                {
+                    if (conn.fd >= 0 && conn.current && now - conn.last_seen > HeartbeatTimeout)
+                    {
+                        if (verbosity_ > 0)
+                        {
+                            std::cerr << "Worker timed out" << std::endl;
+                        }
+                        drop(conn);
+                    }
+                }
+                connections.remove_if([](connection const &conn)
+                                      { return conn.fd < 0; });
+                if (fds.front().revents & POLLIN)
+                {
+                    int fd = accept(listener, nullptr, nullptr);
+                    if (fd >= 0)
+                    {
+                        int const on = 1;
+                        setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+                        connections.push_back(connection{fd});
+                    }
+                }
+                for (auto &conn : connections)
+                {
+                    if (conn.ready && !conn.current)
+                    {
+                        assign(conn);
+                    }
+                }
+                connections.remove_if([](connection const &conn)
+                                      { return conn.fd < 0; });
+            }
+            for (auto &conn : connections)
+            {
+                send_line(conn.fd, "DONE");
+                close(conn.fd);
+            }
+            close(listener);
+            if (address.starts_with(UnixPrefix))
+            {
+                unlink(address.substr(UnixPrefix.size()).c_str());
+            }
+            return ok;
+        }
+#else
+        bool coordinator::run(std::string const &)
+        {
+            print_error("distributed mode is not supported on Windows");
+            return false;
+        }
+#endif
+
+        worker::worker(dirb_runner &runner, std::size_t num_threads)
+            : runner_(runner), num_threads_(num_threads)
+        {
+            runner_.set_result_handler([this](std::string_view result)
+                                       { results_.emplace_back(result); });
+        }
+
+#if !defined(_WIN32)
+        bool worker::run(std::string const &address)
+        {
+            std::signal(SIGPIPE, SIG_IGN);
+            int fd = open_socket(address, false);
+            if (fd < 0)
+            {
+                return false;
+            }
+            std::ostringstream hello;
+            hello << "HELLO " << runner_.candidate_count() << ' ' << std::hex << runner_.candidate_fingerprint();
+            bool ok = send_line(fd, hello.str());
+            std::string buffer;
+            std::string line;
+            while (ok)
+            {
+                if (!take_line(buffer, line))
+                {
+                    if (!receive(fd, buffer))
+                    {
+                        print_error("connection to coordinator lost");
+                        ok = false;
+                    }
+                    continue;
+                }
+                std::istringstream is(line);
+                std::string command;
+                is >> command;
+                if (command == "DONE")
+                {
+                    break;
+                }
+                std::size_t id;
+                std::size_t begin;
+                std::size_t end;
+                int qualify_urls;
+                std::string base_url;
+                if (command != "LEASE" || !(is >> id >> begin >> end >> qualify_urls >> base_url) || begin > end)
+                {
+                    print_error("coordinator: " + line);
+                    ok = false;
+                    break;
+                }
+                results_.clear();
+                runner_.set_base_url(base_url);
+                runner_.set_qualify_urls(qualify_urls != 0);
+                runner_.set_candidate_range(begin, end);
+                {
+                    // only the heartbeat thread writes to the socket until the lease is done
+                    std::mutex mutex;
+                    std::condition_variable cv;
+                    bool lease_done = false;
+                    std::thread heartbeat([&]
+                                          {
+                                              std::unique_lock<std::mutex> lock(mutex);
+                                              while (!cv.wait_for(lock, HeartbeatInterval, [&lease_done]
+                                                                  { return lease_done; }))
+                                              {
+                                                  send_line(fd, "ALIVE");
+                                              } });
+                    runner_.run(std::min(num_threads_, end - begin));
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        lease_done = true;
+                    }
+                    cv.notify_one();
+                    heartbeat.join();
+                }
+                for (auto const &result : results_)
+                {
+                    ok = ok && send_line(fd, "RESULT " + std::to_string(id) + ' ' + result);
+                }
+                ok = ok && send_line(fd, "COMPLETE " + std::to_string(id));
+                if (!ok)
+                {
+                    print_error("connection to coordinator lost");
+                }
+            }
+            close(fd);
+            return ok;
+        }
+#else
+        bool worker::run(std::string const &)
+        {
+            print_error("distributed mode is not supported on Windows");
+            return false;
+        }
+#endif
+    }
+}
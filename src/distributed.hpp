@@ -0,0 +1,125 @@
+/*
+ * Dirb++ - Fast, multithreaded version of the original Dirb
+ * Copyright (c) 2023 Oliver Lau <oliver.lau@gmail.com>
+ */
+
+#ifndef __DISTRIBUTED_HPP__
+#define __DISTRIBUTED_HPP__
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "dirb.hpp"
+
+/**
+ * Distributed scan mode.
+ *
+ * A coordinator partitions the candidate space (targets × word list ×
+ * mutation rules) into leases of consecutive candidate indexes and hands
+ * them out to worker processes connected via a Unix domain socket
+ * (`unix:/path/to/socket`) or TCP (`host:port`). All processes must be
+ * started with the same word lists, word statistics and mutation rules;
+ * the worker reports the size and a fingerprint of its candidate space,
+ * and the coordinator rejects workers whose candidate space differs.
+ *
+ * The protocol is line-based:
+ *
+ *   worker → coordinator:  HELLO <candidate count> <fingerprint>
+ *   coordinator → worker:  LEASE <id> <begin> <end> <full urls> <base url> | DONE | ERROR <message>
+ *   worker → coordinator:  ALIVE ... RESULT <id> <result line> ... COMPLETE <id>
+ *
+ * `<full urls>` is 1 if there are several base URLs; the worker then
+ * reports full URLs instead of paths, so that results can be told apart.
+ * While scanning a lease, the worker sends ALIVE every `HeartbeatInterval`.
+ * The coordinator buffers the results of a lease until it is complete,
+ * and prints them in the regular output format. If a worker disconnects
+ * or stays silent for `HeartbeatTimeout` while holding a lease, its
+ * connection is closed and the lease is re-issued to another worker.
+ */
+namespace dirb
+{
+    namespace distributed
+    {
+        constexpr std::chrono::seconds HeartbeatInterval{5};
+        constexpr std::chrono::seconds HeartbeatTimeout{30};
+
+        class coordinator final
+        {
+        public:
+            static constexpr std::size_t DefaultLeaseSize = 1000U;
+
+            coordinator(std::vector<std::string> const &targets, std::size_t candidate_count, std::uint64_t fingerprint)
+                : targets_(targets), candidate_count_(candidate_count), fingerprint_(fingerprint){};
+            coordinator(coordinator const &) = delete;
+            coordinator(coordinator &&) = delete;
+            inline void set_lease_size(std::size_t lease_size)
+            {
+                this->lease_size_ = lease_size;
+            }
+            inline void set_verbosity(int verbosity)
+            {
+                this->verbosity_ = verbosity;
+            }
+
+            /**
+             * Listens on `address` and serves leases until the whole
+             * candidate space has been scanned. Returns false on error.
+             */
+            bool run(std::string const &address);
+
+        private:
+            struct lease
+            {
+                std::size_t id;
+                std::size_t target;
+                std::size_t begin;
+                std::size_t end;
+            };
+
+            struct connection;
+
+            std::vector<std::string> targets_;
+            std::size_t candidate_count_;
+            std::uint64_t fingerprint_;
+            std::size_t lease_size_{DefaultLeaseSize};
+            int verbosity_{0};
+            std::deque<lease> reissued_{};
+            std::size_t next_lease_id_{0};
+            std::size_t next_target_{0};
+            std::size_t next_begin_{0};
+            std::size_t completed_{0};
+
+            std::size_t total_leases() const;
+            bool next_lease(lease &l);
+            void assign(connection &conn);
+            bool handle_line(connection &conn, std::string const &line);
+            void drop(connection &conn);
+        };
+
+        class worker final
+        {
+        public:
+            worker(dirb_runner &runner, std::size_t num_threads);
+            worker(worker const &) = delete;
+            worker(worker &&) = delete;
+
+            /**
+             * Connects to the coordinator at `address` and scans leases
+             * until the coordinator signals that all work is done.
+             * Returns false on error.
+             */
+            bool run(std::string const &address);
+
+        private:
+            dirb_runner &runner_;
+            std::size_t num_threads_;
+            std::vector<std::string> results_{};
+        };
+    }
+}
+
+#endif // __DISTRIBUTED_HPP__
@@ -19,7 +19,10 @@
 
 #include "timer.hpp"
 #include "util.hpp"
+#include "cache.hpp"
 #include "dirb.hpp"
+#include "distributed.hpp"
+#include "mutator.hpp"
 
 #include "certs.hpp"
 
@@ -68,7 +71,7 @@ namespace
     void brief_usage()
     {
         std::cout
-            << "USAGE: " << PROJECT_NAME << " [options] base_url\n"
+            << "USAGE: " << PROJECT_NAME << " [options] base_url [base_url ...]\n"
             << "\n"
             << "See `" << PROJECT_NAME << " --help` for options\n";
     }
@@ -79,13 +82,15 @@ namespace
             << "\n"
                "USAGE: "
             << PROJECT_NAME
-            << " [options] base_url\n"
+            << " [options] base_url [base_url ...]\n"
                "\n"
                "  base_url\n"
                "\n"
                "       The base URL used for all URL queries,\n"
                "       e.g. `http://example.com` or `https://example.com`\n"
                "       (no trailing slash!)\n"
+               "       Several base URLs are scanned one after the other;\n"
+               "       results then show full URLs instead of paths.\n"
                "\n"
                "OPTIONS:\n"
                "\n"
@@ -93,12 +98,16 @@ namespace
                "    Add word list file\n"
                "\n"
                "  -v [--verbose]\n"
-               "    Increase verbosity of output (only applies to standard output mode)\n"
+               "    Increase verbosity of output; diagnostics go to standard error\n"
                "\n"
                "  -t N [--threads N]\n"
                "    Run in N threads (default: "
             << DefaultNumThreads << "\n"
             << "\n"
+               "  --pin\n"
+               "    Pin each worker thread to a CPU. Workers are spread across\n"
+               "    NUMA nodes, and their buffers are allocated node-locally.\n"
+               "\n"
                "  -p USERNAME:PASSWORD [--credentials ...]\n"
                "    Enable basic authentication with USERNAME and PASSWORD\n"
                "\n"
@@ -144,6 +153,19 @@ namespace
                "    path by adding these extensions, delimited by comma. E.g.:\n"
                "      -X .jsp,.php,.phpx,.xhtml\n"
                "\n"
+               "  -M RULE [--mutate ...]\n"
+               "    Derive additional paths from each word in the word lists.\n"
+               "    Can be given multiple times; rules are combined as a product\n"
+               "    and applied in order. Every rule keeps the unmodified path.\n"
+               "    Candidates are generated on the fly, not held in memory.\n"
+               "    RULE is one of:\n"
+               "      case:lower,upper,capitalize\n"
+               "      prefix:P1,P2,...Pn\n"
+               "      suffix:S1,S2,...Sn\n"
+               "      backup (same as suffix:~,.bak,.old)\n"
+               "      range:FROM-TO (leading zeros pad numbers, e.g. range:001-999)\n"
+               "    E.g.: -M case:lower,upper -M backup\n"
+               "\n"
                "  -V EXT1,EXT2,...EXTn [--probe-variations ...]\n"
                "    If a path is found, check these variations by appending them\n"
                "    to the path, delimited by comma. E.g.:\n"
@@ -156,6 +178,43 @@ namespace
                "    Enable verification of CA certificates\n"
                "    (only applies to HTTPS requests)\n"
                "\n"
+               "  --cache FILENAME\n"
+               "    Keep status, ETag, Last-Modified, length and body hash of\n"
+               "    all findings in FILENAME. Findings from previous scans are\n"
+               "    revalidated with If-None-Match/If-Modified-Since requests;\n"
+               "    a 304 response counts as unchanged.\n"
+               "\n"
+               "  --diff\n"
+               "    Only report findings that are new or changed compared to\n"
+               "    the cache (requires --cache)\n"
+               "\n"
+               "  --word-stats FILENAME\n"
+               "    Probe frequent words first. FILENAME contains one word and\n"
+               "    its frequency (e.g. the number of hits in past scans) per\n"
+               "    line, separated by whitespace. With --cache, words that were\n"
+               "    findings in the previous scan are probed before all others.\n"
+               "\n"
+               "  --fifo\n"
+               "    Probe paths strictly in word list order, variations (-V)\n"
+               "    after the word list; disables all prioritization (e.g. to\n"
+               "    compare time to first findings)\n"
+               "\n"
+               "  --coordinator ADDRESS\n"
+               "    Do not scan, but distribute the scan across worker processes\n"
+               "    connecting to ADDRESS, which is either HOST:PORT or\n"
+               "    unix:/path/to/socket. Workers must be given the same word\n"
+               "    lists, --word-stats and -X/-M options as the coordinator.\n"
+               "    -t, --pin, --cache and --diff apply to workers only.\n"
+               "\n"
+               "  --worker ADDRESS\n"
+               "    Scan the parts of the candidate space handed out by the\n"
+               "    coordinator at ADDRESS. No base_url required.\n"
+               "\n"
+               "  --lease-size N\n"
+               "    Number of candidates the coordinator hands out per lease\n"
+               "    (default: "
+            << dirb::distributed::coordinator::DefaultLeaseSize << ")\n"
+            << "\n"
                "  --license\n"
                "    Display license\n"
                "\n";
@@ -165,10 +224,19 @@ namespace
 int main(int argc, char *argv[])
 {
     std::size_t num_threads{DefaultNumThreads};
+    bool num_threads_given{false};
+    bool pin_threads{false};
     std::vector<std::string> word_list_filenames{};
     dirb::dirb_runner dirb_runner{};
     std::string user_agent{dirb::dirb_runner::DefaultUserAgent};
-    std::vector<std::string> probe_extensions{};
+    dirb::mutator mutator{};
+    std::vector<std::string> base_urls{};
+    std::string coordinator_address{};
+    std::string worker_address{};
+    std::size_t lease_size{dirb::distributed::coordinator::DefaultLeaseSize};
+    std::string cache_filename{};
+    bool diff_mode{false};
+    std::string word_stats_filename{};
     int verbosity{0};
     using argparser = argparser::argparser;
     argparser opt{argc, argv};
@@ -180,14 +248,35 @@ int main(int argc, char *argv[])
              [&verbosity](std::string const &)
              { ++verbosity; })
         .reg({"-t", "--threads"}, argparser::required_argument,
-             [&num_threads](std::string const &val)
-             { num_threads = static_cast<unsigned int>(std::stoi(val)); })
+             [&num_threads, &num_threads_given](std::string const &val)
+             {
+                 num_threads = static_cast<unsigned int>(std::stoi(val));
+                 num_threads_given = true;
+             })
+        .reg({"--pin"}, argparser::no_argument,
+             [&pin_threads](std::string const &)
+             { pin_threads = true; })
         .reg({"-H", "--header"}, argparser::required_argument,
              [&dirb_runner](std::string const &val)
              { dirb_runner.add_header(util::unpair(val, ':')); })
         .reg({"-X", "--probe-extensions"}, argparser::required_argument,
-             [&probe_extensions](std::string const &val)
-             { probe_extensions = util::split(val, ','); })
+             [&mutator](std::string const &val)
+             {
+                 if (!mutator.add_suffixes(util::split(val, ',')))
+                 {
+                     std::cerr << "\u001b[31;1mERROR:\u001b[0m Invalid probe extensions '" << val << "'.\n";
+                     exit(EXIT_FAILURE);
+                 }
+             })
+        .reg({"-M", "--mutate"}, argparser::required_argument,
+             [&mutator](std::string const &val)
+             {
+                 if (!mutator.add_rule(val))
+                 {
+                     std::cerr << "\u001b[31;1mERROR:\u001b[0m Invalid mutation rule '" << val << "'.\n";
+                     exit(EXIT_FAILURE);
+                 }
+             })
         .reg({"-V", "--probe-variations"}, argparser::required_argument,
              [&dirb_runner](std::string const &val)
              { dirb_runner.set_probe_variations(util::split(val, ',')); })
@@ -282,8 +371,29 @@ int main(int argc, char *argv[])
                  license();
                  exit(EXIT_SUCCESS);
              })
-        .pos([&dirb_runner](std::string const &val)
-             { dirb_runner.set_base_url(val); });
+        .reg({"--cache"}, argparser::required_argument,
+             [&cache_filename](std::string const &val)
+             { cache_filename = val; })
+        .reg({"--diff"}, argparser::no_argument,
+             [&diff_mode](std::string const &)
+             { diff_mode = true; })
+        .reg({"--word-stats"}, argparser::required_argument,
+             [&word_stats_filename](std::string const &val)
+             { word_stats_filename = val; })
+        .reg({"--fifo"}, argparser::no_argument,
+             [&dirb_runner](std::string const &)
+             { dirb_runner.set_fifo(true); })
+        .reg({"--coordinator"}, argparser::required_argument,
+             [&coordinator_address](std::string const &val)
+             { coordinator_address = val; })
+        .reg({"--worker"}, argparser::required_argument,
+             [&worker_address](std::string const &val)
+             { worker_address = val; })
+        .reg({"--lease-size"}, argparser::required_argument,
+             [&lease_size](std::string const &val)
+             { lease_size = std::max<std::size_t>(1U, std::stoul(val)); })
+        .pos([&base_urls](std::string const &val)
+             { base_urls.push_back(val); });
     try
     {
         opt();
@@ -293,17 +403,55 @@ int main(int argc, char *argv[])
         std::cerr << e.what() << '\n';
     }
 
-    if (!dirb_runner.has_base_url())
+    if (base_urls.empty() && worker_address.empty())
     {
         about();
         brief_usage();
         return EXIT_FAILURE;
     }
+    if (diff_mode && cache_filename.empty())
+    {
+        std::cerr << "\u001b[31;1mERROR:\u001b[0m --diff requires --cache.\n";
+        return EXIT_FAILURE;
+    }
+    if (!coordinator_address.empty())
+    {
+        // the coordinator does not scan; these options only apply to workers
+        std::vector<std::string> scan_options;
+        if (num_threads_given)
+        {
+            scan_options.push_back("-t");
+        }
+        if (pin_threads)
+        {
+            scan_options.push_back("--pin");
+        }
+        if (!cache_filename.empty())
+        {
+            scan_options.push_back("--cache");
+        }
+        if (diff_mode)
+        {
+            scan_options.push_back("--diff");
+        }
+        if (!scan_options.empty())
+        {
+            std::cerr << "\u001b[31;1mERROR:\u001b[0m " << util::join(scan_options, ", ")
+                      << " cannot be used with --coordinator; pass them to the workers instead.\n";
+            return EXIT_FAILURE;
+        }
+    }
+    dirb_runner.set_pin_threads(pin_threads);
     dirb_runner.add_header("User-Agent", user_agent);
+    if (!dirb_runner.set_mutator(mutator))
+    {
+        std::cerr << "\u001b[31;1mERROR:\u001b[0m Too many candidates; reduce the word lists or mutation rules.\n";
+        return EXIT_FAILURE;
+    }
 
     if (verbosity > 1)
     {
-        std::cout << "Reading word list" << (word_list_filenames.size() == 1 ? "" : "s") << " ... " << std::flush;
+        std::cerr << "Reading word list" << (word_list_filenames.size() == 1 ? "" : "s") << " ... " << std::flush;
     }
     for (std::string const &word_list_filename : word_list_filenames)
     {
@@ -311,35 +459,109 @@ int main(int argc, char *argv[])
         std::string line;
         while (std::getline(is, line))
         {
-            dirb_runner.add_to_queue(line);
-            for (auto const &ext : probe_extensions)
+            if (!dirb_runner.add_word(line))
             {
-                dirb_runner.add_to_queue(line + ext);
+                std::cerr << "\u001b[31;1mERROR:\u001b[0m Too many candidates; reduce the word lists or mutation rules.\n";
+                return EXIT_FAILURE;
             }
         }
     }
-    num_threads = std::min(num_threads, dirb_runner.url_queue_size());
-    if (verbosity > 0)
+    std::unordered_map<std::string, std::size_t> word_frequencies;
+    if (!word_stats_filename.empty())
     {
-        std::cout << "Read " << dirb_runner.url_queue_size() << " URLs." << std::endl;
-        std::cout << "Starting " << num_threads << " worker threads ..." << std::endl;
+        std::ifstream is(word_stats_filename);
+        if (!is)
+        {
+            std::cerr << "\u001b[31;1mERROR:\u001b[0m Cannot read word statistics file '" << word_stats_filename << "'.\n";
+            return EXIT_FAILURE;
+        }
+        std::string word;
+        std::size_t frequency;
+        while (is >> word >> frequency)
+        {
+            word_frequencies[word] += frequency;
+        }
+        // same order in all processes of a distributed scan
+        dirb_runner.prioritize_words(word_frequencies, {});
     }
-    std::vector<std::thread> workers;
-    workers.reserve(num_threads);
-    timer t;
-    for (std::size_t i = 0; i < num_threads; ++i)
+    if (!coordinator_address.empty())
+    {
+        dirb::distributed::coordinator coordinator{base_urls, dirb_runner.candidate_count(), dirb_runner.candidate_fingerprint()};
+        coordinator.set_lease_size(lease_size);
+        coordinator.set_verbosity(verbosity);
+        return coordinator.run(coordinator_address) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    dirb::response_cache response_cache{};
+    if (!cache_filename.empty())
+    {
+        if (!response_cache.load(cache_filename))
+        {
+            std::cerr << "\u001b[31;1mERROR:\u001b[0m Cannot read cache file '" << cache_filename << "'.\n";
+            return EXIT_FAILURE;
+        }
+        dirb_runner.set_response_cache(&response_cache);
+        dirb_runner.set_diff_mode(diff_mode);
+    }
+    auto save_cache = [&cache_filename, &response_cache]()
+    {
+        if (!cache_filename.empty() && !response_cache.save(cache_filename))
+        {
+            std::cerr << "\u001b[31;1mERROR:\u001b[0m Cannot write cache file '" << cache_filename << "'.\n";
+            return false;
+        }
+        return true;
+    };
+    if (!worker_address.empty())
+    {
+        dirb::distributed::worker worker{dirb_runner, num_threads};
+        bool const ok = worker.run(worker_address);
+        return save_cache() && ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    num_threads = std::min(num_threads, dirb_runner.candidate_count());
+    if (verbosity > 0)
     {
-        workers.emplace_back(&dirb::dirb_runner::http_worker, &dirb_runner);
+        std::cerr << "Generating " << dirb_runner.candidate_count() << " URLs"
+                  << (base_urls.size() > 1 ? " per base URL." : ".") << std::endl;
+        std::cerr << "Starting " << num_threads << " worker threads ..." << std::endl;
     }
-    for (auto &worker : workers)
+    dirb_runner.set_qualify_urls(base_urls.size() > 1);
+    timer t;
+    for (auto const &base_url : base_urls)
     {
-        worker.join();
+        if (!cache_filename.empty())
+        {
+            auto const &hits = response_cache.source_words(base_url);
+            dirb_runner.prioritize_words(word_frequencies, {hits.begin(), hits.end()});
+        }
+        dirb_runner.set_base_url(base_url);
+        dirb_runner.set_candidate_range(0, dirb_runner.candidate_count());
+        dirb_runner.run(num_threads);
     }
     if (verbosity > 0)
     {
-        std::cout << "Elapsed time: "
-                  << chrono::duration_cast<chrono::milliseconds>(t.elapsed()).count() << " ms"
-                  << std::endl;
+        auto const elapsed_ms = chrono::duration_cast<chrono::milliseconds>(t.elapsed()).count();
+        double const requests_per_sec = elapsed_ms > 0
+                                            ? 1e3 * static_cast<double>(dirb_runner.request_count()) / static_cast<double>(elapsed_ms)
+                                            : 0.0;
+        std::cerr << "Elapsed time: " << elapsed_ms << " ms" << std::endl;
+        std::cerr << "Requests: " << dirb_runner.request_count()
+                  << " (" << requests_per_sec << " req/s)" << std::endl;
+        auto const &worker_requests = dirb_runner.worker_request_counts();
+        if (!worker_requests.empty() && elapsed_ms > 0)
+        {
+            auto const [min_requests, max_requests] = std::minmax_element(worker_requests.begin(), worker_requests.end());
+            std::cerr << "Per thread: min "
+                      << 1e3 * static_cast<double>(*min_requests) / static_cast<double>(elapsed_ms) << " req/s, max "
+                      << 1e3 * static_cast<double>(*max_requests) / static_cast<double>(elapsed_ms) << " req/s"
+                      << std::endl;
+        }
+        auto const &finding_times = dirb_runner.finding_times();
+        for (std::size_t n = 1; n <= finding_times.size(); n *= 10)
+        {
+            std::cerr << "Time to first " << n << " finding" << (n == 1 ? "" : "s") << ": "
+                      << chrono::duration_cast<chrono::milliseconds>(finding_times.at(n - 1)).count() << " ms"
+                      << std::endl;
+        }
     }
-    return EXIT_SUCCESS;
+    return save_cache() ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,273 @@
+/*
+ * Dirb++ - Fast, multithreaded version of the original Dirb
+ * Copyright (c) 2023 Oliver Lau <oliver.lau@gmail.com>
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "mutator.hpp"
+#include "util.hpp"
+
+namespace dirb
+{
+    namespace
+    {
+        bool parse_number(std::string const &str, unsigned long long &value)
+        {
+            if (str.empty() || !std::all_of(str.begin(), str.end(), [](unsigned char c)
+                                            { return std::isdigit(c); }))
+            {
+                return false;
+            }
+            try
+            {
+                value = std::stoull(str);
+            }
+            catch (std::out_of_range const &)
+            {
+                return false;
+            }
+            return true;
+        }
+    }
+
+    std::size_t mutator::rule::size() const
+    {
+        // every rule adds the unmodified word as variant 0
+        switch (type)
+        {
+        case rule_type::case_variants:
+            return cases.size() + 1;
+        case rule_type::prefixes:
+            // fall-through
+        case rule_type::suffixes:
+            return affixes.size() + 1;
+        case rule_type::numeric_range:
+            return static_cast<std::size_t>(to - from) + 2;
+        }
+        return 1;
+    }
+
+    bool mutator::add(rule &&r)
+    {
+        if (r.type == rule_type::numeric_range && r.to - r.from >= std::numeric_limits<std::size_t>::max() - 2)
+        {
+            return false;
+        }
+        std::size_t const n = r.size();
+        if (n < 2 || variants_per_word_ > std::numeric_limits<std::size_t>::max() / n)
+        {
+            return false;
+        }
+        variants_per_word_ *= n;
+        rules_.push_back(std::move(r));
+        return true;
+    }
+
+    bool mutator::add_case_variants(std::vector<case_variant> const &variants)
+    {
+        return add(rule{.type = rule_type::case_variants, .cases = variants});
+    }
+
+    bool mutator::add_prefixes(std::vector<std::string> const &prefixes)
+    {
+        return add(rule{.type = rule_type::prefixes, .affixes = prefixes});
+    }
+
+    bool mutator::add_suffixes(std::vector<std::string> const &suffixes)
+    {
+        return add(rule{.type = rule_type::suffixes, .affixes = suffixes});
+    }
+
+    bool mutator::add_numeric_range(unsigned long long from, unsigned long long to, std::size_t width)
+    {
+        if (from > to)
+        {
+            return false;
+        }
+        return add(rule{.type = rule_type::numeric_range, .from = from, .to = to, .width = width});
+    }
+
+    bool mutator::add_rule(std::string const &spec)
+    {
+        auto const &[name, args] = util::unpair(spec, ':');
+        if (name == "backup")
+        {
+            return args.empty() && add_suffixes({"~", ".bak", ".old"});
+        }
+        if (name == "prefix")
+        {
+            return add_prefixes(util::split(args, ','));
+        }
+        if (name == "suffix")
+        {
+            return add_suffixes(util::split(args, ','));
+        }
+        if (name == "case")
+        {
+            std::vector<case_variant> variants;
+            for (auto const &variant : util::split(args, ','))
+            {
+                if (variant == "lower")
+                {
+                    variants.push_back(case_variant::lower);
+                }
+                else if (variant == "upper")
+                {
+                    variants.push_back(case_variant::upper);
+                }
+                else if (variant == "capitalize")
+                {
+                    variants.push_back(case_variant::capitalize);
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            return add_case_variants(variants);
+        }
+        if (name == "range")
+        {
+            auto const &[from_str, to_str] = util::unpair(args, '-');
+            unsigned long long from;
+            unsigned long long to;
+            if (!parse_number(from_str, from) || !parse_number(to_str, to))
+            {
+                return false;
+            }
+            // leading zeros request zero-padded numbers, e.g. `001-999`
+            std::size_t const width = (from_str.size() > 1 && from_str.front() == '0') ? from_str.size() : 0;
+            return add_numeric_range(from, to, width);
+        }
+        return false;
+    }
+
+    std::string mutator::describe() const
+    {
+        std::string description;
+        for (auto const &r : rules_)
+        {
+            switch (r.type)
+            {
+            case rule_type::case_variants:
+                description.append("case");
+                for (auto c : r.cases)
+                {
+                    description.append(1, '\x1f').append(std::to_string(static_cast<int>(c)));
+                }
+                break;
+            case rule_type::prefixes:
+                // fall-through
+            case rule_type::suffixes:
+                description.append(r.type == rule_type::prefixes ? "prefix" : "suffix");
+                for (auto const &affix : r.affixes)
+                {
+                    description.append(1, '\x1f').append(affix);
+                }
+                break;
+            case rule_type::numeric_range:
+                description.append("range\x1f")
+                    .append(std::to_string(r.from))
+                    .append(1, '\x1f')
+                    .append(std::to_string(r.to))
+                    .append(1, '\x1f')
+                    .append(std::to_string(r.width));
+                break;
+            }
+            description.append(1, '\x1e');
+        }
+        return description;
+    }
+
+    std::string mutator::apply(std::string const &word, std::size_t index) const
+    {
+        std::string candidate{word};
+        apply_rules(candidate, index);
+        return candidate;
+    }
+
+    bool mutator::apply(std::string const &word, std::size_t index, std::string &candidate) const
+    {
+        candidate.assign(word);
+        return apply_rules(candidate, index);
+    }
+
+    template <typename StringT>
+    bool mutator::apply_rules(StringT &candidate, std::size_t index) const
+    {
+        auto is_upper = [](unsigned char c)
+        {
+            return std::isupper(c) != 0;
+        };
+        auto is_lower = [](unsigned char c)
+        {
+            return std::islower(c) != 0;
+        };
+        bool distinct = true;
+        for (auto const &r : rules_)
+        {
+            std::size_t const n = r.size();
+            std::size_t const i = index % n;
+            index /= n;
+            if (i == 0)
+            {
+                continue;
+            }
+            switch (r.type)
+            {
+            case rule_type::case_variants:
+                switch (r.cases.at(i - 1))
+                {
+                case case_variant::as_is:
+                    break;
+                case case_variant::lower:
+                    distinct = distinct && std::any_of(candidate.begin(), candidate.end(), is_upper);
+                    std::transform(candidate.begin(), candidate.end(), candidate.begin(), [](unsigned char c)
+                                   { return static_cast<char>(std::tolower(c)); });
+                    break;
+                case case_variant::upper:
+                    distinct = distinct && std::any_of(candidate.begin(), candidate.end(), is_lower);
+                    std::transform(candidate.begin(), candidate.end(), candidate.begin(), [](unsigned char c)
+                                   { return static_cast<char>(std::toupper(c)); });
+                    break;
+                case case_variant::capitalize:
+                    distinct = distinct && !candidate.empty() &&
+                               (is_lower(static_cast<unsigned char>(candidate.front())) ||
+                                std::any_of(std::next(candidate.begin()), candidate.end(), is_upper));
+                    std::transform(candidate.begin(), candidate.end(), candidate.begin(), [](unsigned char c)
+                                   { return static_cast<char>(std::tolower(c)); });
+                    if (!candidate.empty())
+                    {
+                        candidate.front() = static_cast<char>(std::toupper(static_cast<unsigned char>(candidate.front())));
+                    }
+                    break;
+                }
+                break;
+            case rule_type::prefixes:
+                candidate.insert(0, r.affixes.at(i - 1));
+                break;
+            case rule_type::suffixes:
+                candidate.append(r.affixes.at(i - 1));
+                break;
+            case rule_type::numeric_range:
+            {
+                std::string number = std::to_string(r.from + (i - 1));
+                if (number.size() < r.width)
+                {
+                    number.insert(0, r.width - number.size(), '0');
+                }
+                candidate.append(number);
+                break;
+            }
+            }
+        }
+        return distinct;
+    }
+
+}
@@ -0,0 +1,119 @@
+/*
+ * Dirb++ - Fast, multithreaded version of the original Dirb
+ * Copyright (c) 2023 Oliver Lau <oliver.lau@gmail.com>
+ */
+
+#ifndef __MUTATOR_HPP__
+#define __MUTATOR_HPP__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace dirb
+{
+
+    /**
+     * Generates path candidates from a word by applying a product of
+     * mutation rules. Rules are stored as compact descriptors; the
+     * candidates themselves are never materialized but computed on
+     * demand from their index in the product space.
+     *
+     * Every rule contributes the unmodified word as its first variant,
+     * so stacking rules never drops the original path.
+     */
+    class mutator final
+    {
+    public:
+        enum class case_variant
+        {
+            as_is,
+            lower,
+            upper,
+            capitalize,
+        };
+
+        /**
+         * Adds a rule described by a compact template:
+         *
+         *   case:lower,upper,capitalize
+         *   prefix:P1,P2,...
+         *   suffix:S1,S2,...
+         *   backup                 (same as suffix:~,.bak,.old)
+         *   range:FROM-TO          (e.g. range:1-100 or range:001-999)
+         *
+         * Returns false if the template cannot be parsed.
+         */
+        bool add_rule(std::string const &spec);
+
+        /**
+         * The following functions add a rule directly. They return false
+         * if the rule is empty or the candidate space would overflow.
+         * Rules are applied to the word in the order they were added.
+         */
+        bool add_case_variants(std::vector<case_variant> const &variants);
+        bool add_prefixes(std::vector<std::string> const &prefixes);
+        bool add_suffixes(std::vector<std::string> const &suffixes);
+        bool add_numeric_range(unsigned long long from, unsigned long long to, std::size_t width = 0);
+
+        /**
+         * Number of candidates generated from a single word.
+         */
+        inline std::size_t variants_per_word() const
+        {
+            return variants_per_word_;
+        }
+
+        /**
+         * Canonical description of all rules in the order they were
+         * added, e.g. for comparing the rules of two processes.
+         */
+        std::string describe() const;
+
+        /**
+         * Returns candidate `index` (0 <= index < variants_per_word())
+         * derived from `word`. Index 0 always yields the word itself.
+         */
+        std::string apply(std::string const &word, std::size_t index) const;
+
+        /**
+         * Same as above, but writes the candidate into `candidate`, reusing
+         * its buffer. Returns false if a case rule left the
+         * candidate unchanged, i.e. it repeats a candidate with a lower
+         * index and need not be probed.
+         */
+        bool apply(std::string const &word, std::size_t index, std::string &candidate) const;
+
+    private:
+        enum class rule_type
+        {
+            case_variants,
+            prefixes,
+            suffixes,
+            numeric_range,
+        };
+
+        struct rule
+        {
+            rule_type type;
+            std::vector<case_variant> cases{};
+            std::vector<std::string> affixes{};
+            unsigned long long from{0};
+            unsigned long long to{0};
+            std::size_t width{0};
+
+            std::size_t size() const;
+        };
+
+        std::vector<rule> rules_{};
+        std::size_t variants_per_word_{1};
+
+        bool add(rule &&r);
+
+        template <typename StringT>
+        bool apply_rules(StringT &candidate, std::size_t index) const;
+    };
+
+}
+
+#endif // __MUTATOR_HPP__
@@ -14,7 +14,7 @@
 namespace util
 {
 
-    std::vector<std::string> split(const std::string &str, char delim)
+    inline std::vector<std::string> split(const std::string &str, char delim)
     {
         std::vector<std::string> strings;
         size_t start;
@@ -27,7 +27,7 @@ namespace util
         return strings;
     }
 
-    std::pair<std::string, std::string> unpair(const std::string &str, char delim)
+    inline std::pair<std::string, std::string> unpair(const std::string &str, char delim)
     {
         std::pair<std::string, std::string> pair;
         auto index = str.find(delim);